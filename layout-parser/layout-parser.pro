@@ -17,9 +17,13 @@ TEMPLATE = app
 SOURCES += main.cpp \
     layoutparser.cpp \
     keyboard.cpp \
-    layout.cpp
+    layout.cpp \
+    section.cpp \
+    row.cpp
 
 HEADERS += \
     layoutparser.h \
     keyboard.h \
-    layout.h
+    layout.h \
+    section.h \
+    row.h
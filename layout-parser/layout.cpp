@@ -1,8 +1,10 @@
 #include "layout.h"
 
-Layout::Layout(LayoutType type, LayoutOrientation orientation)
+Layout::Layout(LayoutType type, LayoutOrientation orientation,
+               const QList<QSharedPointer<const Section> > &sections)
     : mType(type),
-      mOrientation(orientation)
+      mOrientation(orientation),
+      mSections(sections)
 {
 }
 
@@ -16,7 +18,21 @@ Layout::LayoutOrientation Layout::orientation() const
     return mOrientation;
 }
 
+const QList<QSharedPointer<const Section> > Layout::sections() const
+{
+    return mSections;
+}
+
 bool Layout::operator==(const Layout& other) const
 {
-    return mType == other.mType && mOrientation == other.mOrientation;
+    if (mType != other.mType || mOrientation != other.mOrientation || mSections.size() != other.mSections.size())
+        return false;
+
+    // Compare sections themselves instead of the pointers
+    for (int i = 0; i < mSections.size(); ++i) {
+        if (!(*mSections.at(i) == *other.mSections.at(i)))
+            return false;
+    }
+
+    return true;
 }
@@ -2,6 +2,10 @@
 #define LAYOUT_H
 
 #include <QObject>
+#include <QList>
+#include <QSharedPointer>
+
+#include "section.h"
 
 class Layout
 {
@@ -20,10 +24,12 @@ public:
         Portrait
     };
 
-    Layout(LayoutType type, LayoutOrientation orientation);
+    Layout(LayoutType type, LayoutOrientation orientation,
+           const QList<QSharedPointer<const Section> > &sections = QList<QSharedPointer<const Section> >());
 
     LayoutType type() const;
     LayoutOrientation orientation() const;
+    const QList<QSharedPointer<const Section> > sections() const;
 
     bool operator==(const Layout& other) const;
 
@@ -32,6 +38,7 @@ private:
 
     const LayoutType mType;
     const LayoutOrientation mOrientation;
+    const QList<QSharedPointer<const Section> > mSections;
 };
 
 #endif // LAYOUT_H
@@ -1,9 +1,104 @@
 #include "layoutparser.h"
 
 #include <QDebug>
+#include <QCryptographicHash>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QScopedPointer>
 
-LayoutParser::LayoutParser(QIODevice *device)
+#include <algorithm>
+
+typedef QHash<QByteArray, QWeakPointer<const Section> > SectionCache;
+typedef QHash<QByteArray, QWeakPointer<const Row> > RowCache;
+
+// Sections and rows are immutable, so with LayoutParser::ShareSubtrees
+// identical subtrees (e.g. the number row shared by portrait and landscape
+// layouts) are interned by the hash of their XML content and shared between
+// all keyboards parsed in this process. The caches only hold weak references;
+// the last strong reference removes the entry again.
+Q_GLOBAL_STATIC(QMutex, sharedMutex)
+Q_GLOBAL_STATIC(SectionCache, sharedSections)
+Q_GLOBAL_STATIC(RowCache, sharedRows)
+
+namespace {
+
+template <class T>
+QHash<QByteArray, QWeakPointer<const T> > *sharedCache();
+
+template <>
+SectionCache *sharedCache<Section>()
+{
+    return sharedSections();
+}
+
+template <>
+RowCache *sharedCache<Row>()
+{
+    return sharedRows();
+}
+
+template <class T>
+struct SharedInstanceDeleter
+{
+    QByteArray digest;
+
+    void operator()(const T *instance) const
+    {
+        QMutex *mutex = sharedMutex();
+        QHash<QByteArray, QWeakPointer<const T> > *cache = sharedCache<T>();
+
+        // Instances released during shutdown may outlive the caches.
+        if (mutex && cache) {
+            QMutexLocker locker(mutex);
+
+            // The digest may already belong to a new instance that was
+            // inserted after this one expired.
+            if (cache->value(digest).isNull())
+                cache->remove(digest);
+        }
+
+        // Deleted outside of the lock, as a section releases its rows here.
+        delete instance;
+    }
+};
+
+template <class T>
+QSharedPointer<const T> sharedInstance(const QByteArray &digest, T *instance)
+{
+    // Declared before the locker, so an unused instance is deleted after the
+    // lock has been released.
+    QScopedPointer<T> candidate(instance);
+    QHash<QByteArray, QWeakPointer<const T> > *cache = sharedCache<T>();
+    QMutexLocker locker(sharedMutex());
+
+    const QSharedPointer<const T> existing = cache->value(digest).toStrongRef();
+    if (existing)
+        return existing;
+
+    const SharedInstanceDeleter<T> deleter = { digest };
+    const QSharedPointer<const T> shared(candidate.take(), deleter);
+    cache->insert(digest, shared);
+    return shared;
+}
+
+bool attributeLessThan(const QXmlStreamAttribute &attribute, const QXmlStreamAttribute &other)
+{
+    return QStringRef::compare(attribute.qualifiedName(), other.qualifiedName()) < 0;
+}
+
+void addField(QCryptographicHash &hash, const QStringRef &field)
+{
+    const int size = field.size();
+    hash.addData(reinterpret_cast<const char *>(&size), sizeof(size));
+    hash.addData(reinterpret_cast<const char *>(field.unicode()), size * sizeof(QChar));
+}
+
+}
+
+LayoutParser::LayoutParser(QIODevice *device, SubtreeSharing sharing)
     : xml(device),
+      mSharing(sharing),
       mKeyboard(),
       mImports(),
       mLayouts()
@@ -113,21 +208,25 @@ void LayoutParser::parseLayout()
     const Layout::LayoutType type = enumValue("type", typeValues, Layout::General);
     const Layout::LayoutOrientation orientation = enumValue("orientation", orientationValues, Layout::Landscape);
 
-    mLayouts.append(QSharedPointer<Layout>(new Layout(type, orientation)));
-
-    bool foundSection = false;
+    QList<QSharedPointer<const Section> > sections;
 
     while (xml.readNextStartElement()) {
         if (xml.name() == QLatin1String("section")) {
-            foundSection = true;
-            parseSection();
+            if (mSharing == ShareSubtrees) {
+                QCryptographicHash hash(QCryptographicHash::Sha1);
+                sections.append(parseSection(&hash));
+            } else {
+                sections.append(parseSection(0));
+            }
         } else {
             error(QString::fromLatin1("Expected '<section>', but got '<%1>'.").arg(xml.name().toString()));
         }
     }
 
-    if (!foundSection)
+    if (sections.isEmpty())
         error(QString::fromLatin1("Expected '<section>'."));
+
+    mLayouts.append(QSharedPointer<Layout>(new Layout(type, orientation, sections)));
 }
 
 template <class E>
@@ -153,47 +252,128 @@ E LayoutParser::enumValue(const char * const attribute, const QStringList &value
     return static_cast<E>(index);
 }
 
-void LayoutParser::parseSection()
+QSharedPointer<const Section> LayoutParser::parseSection(QCryptographicHash *hash)
 {
     Q_ASSERT(xml.isStartElement());
     Q_ASSERT(xml.name() == QLatin1String("section"));
 
+    const QString& id = xml.attributes().value(QLatin1String("id")).toString();
+
+    if (hash)
+        hashStartElement(*hash);
+
+    QList<QSharedPointer<const Row> > rows;
+
     while (xml.readNextStartElement()) {
         if (xml.name() == QLatin1String("row")) {
-            parseRow();
+            if (hash) {
+                QCryptographicHash rowHash(QCryptographicHash::Sha1);
+                rows.append(parseRow(&rowHash));
+                hash->addData(rowHash.result());
+            } else {
+                rows.append(parseRow(0));
+            }
         } else {
             error(QString::fromLatin1("Expected '<row>', but got '<%1>'.").arg(xml.name().toString()));
         }
     }
+
+    Section *section = new Section(id, rows);
+
+    // Never share a section that was only partially read.
+    if (!hash || xml.hasError())
+        return QSharedPointer<const Section>(section);
+
+    return sharedInstance(hash->result(), section);
 }
 
-void LayoutParser::parseRow()
+QSharedPointer<const Row> LayoutParser::parseRow(QCryptographicHash *hash)
 {
     Q_ASSERT(xml.isStartElement());
     Q_ASSERT(xml.name() == QLatin1String("row"));
 
+    if (hash)
+        hashStartElement(*hash);
+
+    int keyCount = 0;
+
     while (xml.readNextStartElement()) {
         if (xml.name() == QLatin1String("key")) {
-            parseKey();
+            ++keyCount;
+            parseKey(hash);
         } else {
             error(QString::fromLatin1("Expected '<key>', but got '<%1>'.").arg(xml.name().toString()));
         }
     }
+
+    Row *row = new Row(keyCount);
+
+    // Never share a row that was only partially read.
+    if (!hash || xml.hasError())
+        return QSharedPointer<const Row>(row);
+
+    return sharedInstance(hash->result(), row);
 }
 
-void LayoutParser::parseKey()
+void LayoutParser::parseKey(QCryptographicHash *rowHash)
 {
     Q_ASSERT(xml.isStartElement());
     Q_ASSERT(xml.name() == QLatin1String("key"));
 
+    if (rowHash)
+        hashStartElement(*rowHash);
+
     while (xml.readNextStartElement()) {
         if (xml.name() == QLatin1String("binding")) {
             // parseBinding();
-            xml.skipCurrentElement();
+            // Bindings are not modelled yet, but rows that only differ in
+            // their labels must not be shared.
+            if (rowHash)
+                hashSubtree(*rowHash);
+            else
+                xml.skipCurrentElement();
         } else {
             error(QString::fromLatin1("Expected '<binding>', but got '<%1>'.").arg(xml.name().toString()));
         }
     }
+
+    if (rowHash)
+        rowHash->addData("E", 1);
+}
+
+void LayoutParser::hashStartElement(QCryptographicHash &hash)
+{
+    Q_ASSERT(xml.isStartElement());
+
+    // Attributes are sorted so that their order in the document does not
+    // matter. Character data is not hashed, as the layout format has none.
+    QXmlStreamAttributes attributes = xml.attributes();
+    if (attributes.size() > 1)
+        std::sort(attributes.begin(), attributes.end(), attributeLessThan);
+
+    const int attributeCount = attributes.size();
+
+    hash.addData("S", 1);
+    addField(hash, xml.name());
+    hash.addData(reinterpret_cast<const char *>(&attributeCount), sizeof(attributeCount));
+
+    foreach (const QXmlStreamAttribute &attribute, attributes) {
+        addField(hash, attribute.qualifiedName());
+        addField(hash, attribute.value());
+    }
+}
+
+void LayoutParser::hashSubtree(QCryptographicHash &hash)
+{
+    Q_ASSERT(xml.isStartElement());
+
+    hashStartElement(hash);
+
+    while (xml.readNextStartElement()) {
+        hashSubtree(hash);
+    }
+
+    hash.addData("E", 1);
 }
 
 void LayoutParser::readToEnd()
@@ -1,11 +1,25 @@
 #ifndef LAYOUTPARSER_H
 #define LAYOUTPARSER_H
 
-c
+#include <QXmlStreamReader>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QList>
+
+#include "keyboard.h"
+#include "layout.h"
+
+class QCryptographicHash;
+
 class LayoutParser
 {
 public:
-    explicit LayoutParser(QIODevice *device);
+    enum SubtreeSharing {
+        NoSharing = 0,
+        ShareSubtrees
+    };
+
+    explicit LayoutParser(QIODevice *device, SubtreeSharing sharing = NoSharing);
 
     bool parse();
 
@@ -17,6 +31,7 @@ public:
 
 private:
     QXmlStreamReader xml;
+    const SubtreeSharing mSharing;
     QSharedPointer<Keyboard> mKeyboard;
     QStringList mImports;
     QList<QSharedPointer<Layout> > mLayouts;
@@ -24,9 +39,11 @@ private:
     void parseKeyboard();
     void parseImport();
     void parseLayout();
-    void parseSection();
-    void parseRow();
-    void parseKey();
+    QSharedPointer<const Section> parseSection(QCryptographicHash *hash);
+    QSharedPointer<const Row> parseRow(QCryptographicHash *hash);
+    void parseKey(QCryptographicHash *rowHash);
+    void hashStartElement(QCryptographicHash &hash);
+    void hashSubtree(QCryptographicHash &hash);
     void findRootElement();
     void readToEnd();
 
@@ -0,0 +1,16 @@
+#include "row.h"
+
+Row::Row(int keyCount)
+    : mKeyCount(keyCount)
+{
+}
+
+int Row::keyCount() const
+{
+    return mKeyCount;
+}
+
+bool Row::operator==(const Row& other) const
+{
+    return mKeyCount == other.mKeyCount;
+}
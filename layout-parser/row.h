@@ -0,0 +1,21 @@
+#ifndef ROW_H
+#define ROW_H
+
+#include <QObject>
+
+class Row
+{
+public:
+    explicit Row(int keyCount);
+
+    int keyCount() const;
+
+    bool operator==(const Row& other) const;
+
+private:
+    Q_DISABLE_COPY(Row)
+
+    const int mKeyCount;
+};
+
+#endif // ROW_H
@@ -0,0 +1,31 @@
+#include "section.h"
+
+Section::Section(const QString &id, const QList<QSharedPointer<const Row> > &rows)
+    : mId(id),
+      mRows(rows)
+{
+}
+
+const QString Section::id() const
+{
+    return mId;
+}
+
+const QList<QSharedPointer<const Row> > Section::rows() const
+{
+    return mRows;
+}
+
+bool Section::operator==(const Section& other) const
+{
+    if (mId != other.mId || mRows.size() != other.mRows.size())
+        return false;
+
+    // Compare rows themselves instead of the pointers
+    for (int i = 0; i < mRows.size(); ++i) {
+        if (!(*mRows.at(i) == *other.mRows.at(i)))
+            return false;
+    }
+
+    return true;
+}
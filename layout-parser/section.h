@@ -0,0 +1,28 @@
+#ifndef SECTION_H
+#define SECTION_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QSharedPointer>
+
+#include "row.h"
+
+class Section
+{
+public:
+    Section(const QString &id, const QList<QSharedPointer<const Row> > &rows);
+
+    const QString id() const;
+    const QList<QSharedPointer<const Row> > rows() const;
+
+    bool operator==(const Section& other) const;
+
+private:
+    Q_DISABLE_COPY(Section)
+
+    const QString mId;
+    const QList<QSharedPointer<const Row> > mRows;
+};
+
+#endif // SECTION_H
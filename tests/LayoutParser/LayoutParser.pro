@@ -15,7 +15,9 @@ TEMPLATE = app
 SOURCES += tst_layoutparsertest.cpp \
     ../../layout-parser/layoutparser.cpp \
     ../../layout-parser/keyboard.cpp \
-    ../../layout-parser/layout.cpp
+    ../../layout-parser/layout.cpp \
+    ../../layout-parser/section.cpp \
+    ../../layout-parser/row.cpp
 
 DEFINES += SRCDIR=\\\"$$PWD/\\\"
 
@@ -25,4 +27,6 @@ INCLUDEPATH += \
 HEADERS += \
     ../../layout-parser/layoutparser.h \
     ../../layout-parser/keyboard.h \
-    ../../layout-parser/layout.h
+    ../../layout-parser/layout.h \
+    ../../layout-parser/section.h \
+    ../../layout-parser/row.h
@@ -25,10 +25,14 @@ private Q_SLOTS:
     void testImportAttributes();
     void testLayoutAttributes_data();
     void testLayoutAttributes();
+    void testSharedSubtrees();
+    void testParseBenchmark_data();
+    void testParseBenchmark();
 
 private:
-    void parseAndVerify(const QByteArray &data);
-    bool parse(const QByteArray &data);
+    void parseAndVerify(const QByteArray &data, LayoutParser::SubtreeSharing sharing = LayoutParser::NoSharing);
+    bool parse(const QByteArray &data, LayoutParser::SubtreeSharing sharing = LayoutParser::NoSharing);
+    QList<QByteArray> corpus() const;
 
     QScopedPointer<LayoutParser> subject;
 };
@@ -67,21 +71,21 @@ void LayoutParserTest::testValidXML()
     parseAndVerify(document);
 }
 
-void LayoutParserTest::parseAndVerify(const QByteArray &document)
+void LayoutParserTest::parseAndVerify(const QByteArray &document, LayoutParser::SubtreeSharing sharing)
 {
-    const bool result = parse(document);
+    const bool result = parse(document, sharing);
     if (!result)
         qDebug() << subject->errorString();
 
     QVERIFY(result);
 }
 
-bool LayoutParserTest::parse(const QByteArray &document)
+bool LayoutParserTest::parse(const QByteArray &document, LayoutParser::SubtreeSharing sharing)
 {
     QByteArray data(document);
     QBuffer buffer(&data);
     buffer.open(QIODevice::ReadOnly);
-    subject.reset(new LayoutParser(&buffer));
+    subject.reset(new LayoutParser(&buffer, sharing));
 
     const bool result = subject->parse();
 
@@ -228,21 +232,31 @@ void LayoutParserTest::testLayoutAttributes_data()
     QTest::addColumn<QList<QSharedPointer<Layout> > >("layouts");
 
     QList<QSharedPointer<Layout> > layouts;
+    QList<QSharedPointer<const Section> > sections;
+    sections << QSharedPointer<const Section>(new Section(QString(), QList<QSharedPointer<const Row> >()));
 
     layouts.clear();
-    layouts << QSharedPointer<Layout>(new Layout(Layout::General, Layout::Landscape));
+    layouts << QSharedPointer<Layout>(new Layout(Layout::General, Layout::Landscape, sections));
     QTest::newRow("default") << QByteArray("<?xml version=\"1.0\" encoding=\"utf-8\"?><keyboard><layout><section/></layout></keyboard>")
                              << layouts;
     layouts.clear();
-    layouts << QSharedPointer<Layout>(new Layout(Layout::General, Layout::Landscape));
+    layouts << QSharedPointer<Layout>(new Layout(Layout::General, Layout::Landscape, sections));
     QTest::newRow("explicit default") << QByteArray("<?xml version=\"1.0\" encoding=\"utf-8\"?><keyboard><layout type=\"general\" orientation=\"landscape\"><section/></layout></keyboard>")
                                       << layouts;
     layouts.clear();
-    layouts << QSharedPointer<Layout>(new Layout(Layout::Email, Layout::Portrait))
-            << QSharedPointer<Layout>(new Layout(Layout::General, Layout::Landscape))
-            << QSharedPointer<Layout>(new Layout(Layout::Common, Layout::Landscape));
+    layouts << QSharedPointer<Layout>(new Layout(Layout::Email, Layout::Portrait, sections))
+            << QSharedPointer<Layout>(new Layout(Layout::General, Layout::Landscape, sections))
+            << QSharedPointer<Layout>(new Layout(Layout::Common, Layout::Landscape, sections));
     QTest::newRow("mixed") << QByteArray("<?xml version=\"1.0\" encoding=\"utf-8\"?><keyboard><layout type=\"email\" orientation=\"portrait\"><section/></layout><layout><section/></layout><layout type=\"common\"><section/></layout></keyboard>")
                            << layouts;
+    QList<QSharedPointer<const Row> > rows;
+    rows << QSharedPointer<const Row>(new Row(2)) << QSharedPointer<const Row>(new Row(1));
+    sections.clear();
+    sections << QSharedPointer<const Section>(new Section(QString::fromLatin1("main"), rows));
+    layouts.clear();
+    layouts << QSharedPointer<Layout>(new Layout(Layout::General, Layout::Landscape, sections));
+    QTest::newRow("sections") << QByteArray("<?xml version=\"1.0\" encoding=\"utf-8\"?><keyboard><layout><section id=\"main\"><row><key/><key/></row><row><key/></row></section></layout></keyboard>")
+                              << layouts;
 }
 
 template<>
@@ -263,6 +277,159 @@ void LayoutParserTest::testLayoutAttributes()
     QCOMPARE(subject->layouts(), layouts);
 }
 
+void LayoutParserTest::testSharedSubtrees()
+{
+    const QByteArray document("<?xml version=\"1.0\" encoding=\"utf-8\"?><keyboard language=\"de\">"
+                              "<layout orientation=\"landscape\"><section id=\"main\"><row><key><binding label=\"1\"/></key></row><row><key><binding label=\"q\"/></key></row></section></layout>"
+                              "<layout orientation=\"portrait\"><section id=\"main\"><row><key><binding label=\"1\"/></key></row><row><key><binding label=\"q\"/></key></row></section></layout>"
+                              "<layout type=\"number\"><section id=\"other\"><row><key><binding label=\"1\"/></key></row><row><key><binding label=\"2\"/></key></row></section></layout>"
+                              "</keyboard>");
+
+    parseAndVerify(document, LayoutParser::ShareSubtrees);
+
+    const QList<QSharedPointer<Layout> > layouts = subject->layouts();
+    QCOMPARE(layouts.size(), 3);
+
+    // Identical sections within a keyboard are shared
+    const QSharedPointer<const Section> section = layouts.at(0)->sections().at(0);
+    QCOMPARE(section.data(), layouts.at(1)->sections().at(0).data());
+
+    // Different sections still share identical rows, but not different ones
+    const QSharedPointer<const Section> other = layouts.at(2)->sections().at(0);
+    QVERIFY(section.data() != other.data());
+    QCOMPARE(other->id(), QString::fromLatin1("other"));
+    QCOMPARE(section->rows().at(0).data(), other->rows().at(0).data());
+    QVERIFY(section->rows().at(1).data() != other->rows().at(1).data());
+    QCOMPARE(section->rows().at(1)->keyCount(), 1);
+
+    // Another keyboard shares the identical number row, regardless of attribute order
+    const QByteArray otherKeyboard("<?xml version=\"1.0\" encoding=\"utf-8\"?><keyboard language=\"fr\">"
+                                   "<layout><section id=\"main\"><row><key><binding label=\"1\"/></key></row><row><key><binding label=\"a\"/></key></row></section></layout>"
+                                   "<layout><section id=\"special\"><row><key width=\"2\" style=\"special\"/></row></section></layout>"
+                                   "<layout><section id=\"special\"><row><key style=\"special\" width=\"2\"/></row></section></layout>"
+                                   "</keyboard>");
+
+    parseAndVerify(otherKeyboard, LayoutParser::ShareSubtrees);
+
+    const QList<QSharedPointer<Layout> > otherLayouts = subject->layouts();
+    QCOMPARE(otherLayouts.at(0)->sections().at(0)->rows().at(0).data(), section->rows().at(0).data());
+    QVERIFY(otherLayouts.at(0)->sections().at(0)->rows().at(1).data() != section->rows().at(1).data());
+    QCOMPARE(otherLayouts.at(1)->sections().at(0).data(), otherLayouts.at(2)->sections().at(0).data());
+
+    // A row that was only partially read is not shared, even though its
+    // keys up to the error match the number row
+    const QByteArray invalid("<?xml version=\"1.0\" encoding=\"utf-8\"?><keyboard>"
+                             "<layout><section id=\"main\"><row><key><binding label=\"1\"/></key><foo/></row></section></layout>"
+                             "</keyboard>");
+
+    QVERIFY(!parse(invalid, LayoutParser::ShareSubtrees));
+    QCOMPARE(subject->layouts().size(), 1);
+    QVERIFY(subject->layouts().at(0)->sections().at(0)->rows().at(0).data() != section->rows().at(0).data());
+
+    // Without sharing, every subtree gets its own instance
+    parseAndVerify(document);
+
+    QVERIFY(subject->layouts().at(0)->sections().at(0).data() != section.data());
+    QVERIFY(subject->layouts().at(0)->sections().at(0).data() != subject->layouts().at(1)->sections().at(0).data());
+}
+
+QList<QByteArray> LayoutParserTest::corpus() const
+{
+    // Portrait and landscape variants of a few languages, which all use the
+    // same number and bottom rows, like real layout packs do.
+    static const char * const languages[][3] = {
+        { "de", "qwertzuiop", "asdfghjkl" },
+        { "en", "qwertyuiop", "asdfghjkl" },
+        { "fr", "azertyuiop", "qsdfghjklm" },
+        { "it", "qwertyuiop", "asdfghjkl" },
+        { "es", "qwertyuiop", "asdfghjklñ" }
+    };
+
+    const QString numberRow = QString::fromLatin1("<row><key><binding label=\"1\"/></key><key><binding label=\"2\"/></key><key><binding label=\"3\"/></key>"
+                                                  "<key><binding label=\"4\"/></key><key><binding label=\"5\"/></key><key><binding label=\"6\"/></key>"
+                                                  "<key><binding label=\"7\"/></key><key><binding label=\"8\"/></key><key><binding label=\"9\"/></key>"
+                                                  "<key><binding label=\"0\"/></key></row>");
+    const QString bottomRow = QString::fromLatin1("<row><key width=\"2\"><binding action=\"sym\"/></key><key width=\"6\"><binding action=\"space\"/></key>"
+                                                  "<key width=\"2\"><binding action=\"return\"/></key></row>");
+
+    QList<QByteArray> documents;
+
+    for (unsigned int i = 0; i < sizeof(languages) / sizeof(languages[0]); ++i) {
+        QString letterRows;
+        for (int row = 1; row < 3; ++row) {
+            letterRows += QString::fromLatin1("<row>");
+            foreach (const QChar &label, QString::fromUtf8(languages[i][row])) {
+                letterRows += QString::fromLatin1("<key><binding label=\"%1\"/><binding shift=\"true\" label=\"%2\"/></key>").arg(label).arg(label.toUpper());
+            }
+            letterRows += QString::fromLatin1("</row>");
+        }
+
+        const QString section = QString::fromLatin1("<section id=\"main\">%1%2%3</section>").arg(numberRow, letterRows, bottomRow);
+
+        documents << QString::fromLatin1("<?xml version=\"1.0\" encoding=\"utf-8\"?><keyboard language=\"%1\">"
+                                         "<layout orientation=\"landscape\">%2</layout><layout orientation=\"portrait\">%2</layout>"
+                                         "</keyboard>").arg(QString::fromLatin1(languages[i][0]), section).toUtf8();
+    }
+
+    return documents;
+}
+
+void LayoutParserTest::testParseBenchmark_data()
+{
+    QTest::addColumn<bool>("sharing");
+
+    QTest::newRow("no sharing") << false;
+    QTest::newRow("sharing") << true;
+}
+
+void LayoutParserTest::testParseBenchmark()
+{
+    QFETCH(bool, sharing);
+
+    const QList<QByteArray> documents = corpus();
+    const LayoutParser::SubtreeSharing mode = sharing ? LayoutParser::ShareSubtrees : LayoutParser::NoSharing;
+
+    QList<QSharedPointer<Layout> > layouts;
+
+    QBENCHMARK {
+        layouts.clear();
+        foreach (const QByteArray &document, documents) {
+            parseAndVerify(document, mode);
+            layouts += subject->layouts();
+        }
+    }
+
+    // Count the section and row instances kept alive by the whole corpus
+    QSet<const Section *> sections;
+    QSet<const Row *> distinctRows;
+    int rows = 0;
+
+    foreach (const QSharedPointer<Layout> &layout, layouts) {
+        foreach (const QSharedPointer<const Section> &section, layout->sections()) {
+            sections.insert(section.data());
+            foreach (const QSharedPointer<const Row> &row, section->rows()) {
+                distinctRows.insert(row.data());
+                ++rows;
+            }
+        }
+    }
+
+    QCOMPARE(layouts.size(), 2 * documents.size());
+    QCOMPARE(rows, 4 * layouts.size());
+
+    if (sharing) {
+        // Portrait and landscape share their section, and en and it have
+        // identical letter rows, so they share one section, too. Only the
+        // number row, the bottom row and three variants of each letter
+        // row remain.
+        QCOMPARE(sections.size(), 4);
+        QCOMPARE(distinctRows.size(), 8);
+    } else {
+        QCOMPARE(sections.size(), layouts.size());
+        QCOMPARE(distinctRows.size(), rows);
+    }
+}
+
 QTEST_MAIN(LayoutParserTest);
 
 #include "tst_layoutparsertest.moc"